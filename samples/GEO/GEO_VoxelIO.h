@@ -0,0 +1,1064 @@
+/*
+ * Copyright (c) 2015
+ *	Side Effects Software Inc.  All rights reserved.
+ *
+ * Redistribution and use of Houdini Development Kit samples in source and
+ * binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. The name of Side Effects Software may not be used to endorse or
+ *    promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIDE EFFECTS SOFTWARE `AS IS' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN
+ * NO EVENT SHALL SIDE EFFECTS SOFTWARE BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *----------------------------------------------------------------------------
+ * Shared reading and writing of the .voxel format, used by both the
+ * GEO_VoxelTranslator and the geo2voxel standalone.
+ *
+ * The ascii form is read from an in memory copy of the file.  The
+ * float block of each volume is split into chunks at whitespace and
+ * the chunks are parsed in parallel straight into the voxel tiles.
+ *
+ * The binary layout, version 1, in native (little endian) byte order:
+ *
+ *	char	magic[4]	"\177VXB"
+ *	int32	version
+ *	int32	tilesize	edge length of the tiles below
+ *	int32	nvolumes
+ *
+ * followed by each volume:
+ *
+ *	int32	namelength
+ *	char	name[]		padded with zeros to a multiple of 4 bytes
+ *	int32	res[3]
+ *	float32	center[3]
+ *	float32	size[3]
+ *	int32	ntiles
+ *	int64	payloadsize	bytes of tile data following the directory
+ *	tile directory, ntiles entries in UT_VoxelArray linear tile order:
+ *	    int32	type	VOXEL_TILE_CONSTANT or VOXEL_TILE_RAW
+ *	    float32	value	the value of a constant tile
+ *	    int64	offset	start of a raw tile within the payload
+ *	payload: raw tiles as float32 with x varying fastest, trimmed to
+ *	    the array resolution like UT_VoxelTile.
+ *
+ * Loading maps the file into memory and copies each raw tile straight
+ * into its UT_VoxelTile, while constant tiles never touch the payload.
+ */
+
+#ifndef __GEO_VoxelIO_h__
+#define __GEO_VoxelIO_h__
+
+#include <GU/GU_Detail.h>
+#include <GU/GU_PrimVolume.h>
+#include <GA/GA_Handle.h>
+#include <UT/UT_Array.h>
+#include <UT/UT_IStream.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_String.h>
+#include <UT/UT_VoxelArray.h>
+#include <UT/UT_WorkBuffer.h>
+#include <SYS/SYS_Math.h>
+
+#include <limits.h>
+#include <math.h>
+#include <ostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace HDK_Sample {
+
+#define VOXEL_BINARY_MAGIC	"\177VXB"
+#define VOXEL_BINARY_VERSION	1
+
+enum
+{
+    VOXEL_TILE_CONSTANT = 0,
+    VOXEL_TILE_RAW = 1
+};
+
+/// Returns true if the four bytes of magic start a binary .voxel file.
+/// Translators are handed their magic number as an int, so we accept
+/// either byte order.
+inline bool
+voxelIsBinaryMagic(unsigned magic)
+{
+    unsigned	be = (0x7fu << 24) | ('V' << 16) | ('X' << 8) | 'B';
+    unsigned	le = ('B' << 24) | ('X' << 16) | ('V' << 8) | 0x7fu;
+
+    return magic == be || magic == le;
+}
+
+/// Creates a named volume primitive with the given resolution, center
+/// and size, as described by either form of the .voxel format.
+inline GU_PrimVolume *
+voxelBuildVolume(GU_Detail *gdp, GA_RWHandleS &name_attrib,
+		 const char *name, const int res[3],
+		 const float center[3], const float size[3])
+{
+    GU_PrimVolume	*vol;
+
+    vol = (GU_PrimVolume *)GU_PrimVolume::build(gdp);
+
+    // Set the name of the primitive
+    name_attrib.set(vol->getMapOffset(), name);
+
+    // Set the center of the volume
+    gdp->setPos3(vol->getPointOffset(0),
+		 UT_Vector3(center[0], center[1], center[2]));
+
+    UT_Matrix3		xform;
+
+    // The GEO_PrimVolume treats the voxel array as a -1 to 1 cube
+    // so its size is 2, so we scale by 0.5 here.
+    xform.identity();
+    xform.scale(size[0]/2, size[1]/2, size[2]/2);
+
+    vol->setTransform(xform);
+
+    UT_VoxelArrayWriteHandleF	handle = vol->getVoxelWriteHandle();
+
+    // Resize the array.
+    handle->size(res[0], res[1], res[2]);
+
+    return vol;
+}
+
+/// Number of voxels stored in a tile.
+inline exint
+voxelTileSize(const UT_VoxelTile<float> *tile)
+{
+    return exint(tile->xres()) * tile->yres() * tile->zres();
+}
+
+/// Bounds checked reading from an in memory copy of a file.
+class voxel_Reader
+{
+public:
+    voxel_Reader(const char *data, exint size)
+	: myData(data), mySize(size), myPos(0) {}
+
+    template <typename T>
+    bool	read(T &val)
+    {
+	if (myPos + (exint)sizeof(T) > mySize)
+	    return false;
+	memcpy(&val, myData + myPos, sizeof(T));
+	myPos += sizeof(T);
+	return true;
+    }
+    bool	skip(exint bytes)
+    {
+	if (bytes < 0 || myPos + bytes > mySize)
+	    return false;
+	myPos += bytes;
+	return true;
+    }
+
+    const char	*data() const { return myData + myPos; }
+    exint	 remaining() const { return mySize - myPos; }
+
+private:
+    const char	*myData;
+    exint	 mySize;
+    exint	 myPos;
+};
+
+/// Maps a whole file read only.  Where mmap isn't available the file is
+/// read into memory instead.
+class voxel_MappedFile
+{
+public:
+    voxel_MappedFile() : myData(0), mySize(0), myMapped(false) {}
+    ~voxel_MappedFile() { close(); }
+
+    bool	open(const char *fname)
+    {
+	close();
+#if !defined(WIN32)
+	int		fd = ::open(fname, O_RDONLY);
+	struct stat	st;
+
+	if (fd < 0)
+	    return false;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+	    void	*map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	    if (map != MAP_FAILED)
+	    {
+		myData = (const char *)map;
+		mySize = st.st_size;
+		myMapped = true;
+	    }
+	}
+	::close(fd);
+	if (myMapped)
+	    return true;
+#endif
+	FILE		*fp = fopen(fname, "rb");
+	char		 buf[65536];
+	size_t		 n;
+
+	if (!fp)
+	    return false;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+	    append(buf, n);
+	fclose(fp);
+	myData = myBuffer.array();
+	mySize = myBuffer.entries();
+	return true;
+    }
+
+    /// Reads whatever is left of a stream that isn't a plain file.  If
+    /// the magic number has already been read it is put back in front.
+    bool	read(UT_IStream &is, bool ate_magic)
+    {
+	char		buf[65536];
+	exint		n;
+
+	close();
+	if (ate_magic)
+	    append(VOXEL_BINARY_MAGIC, 4);
+	while ((n = is.bread(buf, sizeof(buf))) > 0)
+	    append(buf, n);
+	myData = myBuffer.array();
+	mySize = myBuffer.entries();
+	return true;
+    }
+
+    void	close()
+    {
+#if !defined(WIN32)
+	if (myMapped)
+	    munmap((void *)myData, mySize);
+#endif
+	myMapped = false;
+	myData = 0;
+	mySize = 0;
+	myBuffer.setCapacity(0);
+    }
+
+    const char	*data() const { return myData; }
+    exint	 size() const { return mySize; }
+
+private:
+    void	append(const char *buf, exint n)
+    {
+	exint	old = myBuffer.entries();
+
+	myBuffer.setSize(old + n);
+	memcpy(myBuffer.array() + old, buf, n);
+    }
+
+    const char		*myData;
+    exint		 mySize;
+    bool		 myMapped;
+    UT_Array<char>	 myBuffer;
+};
+
+/// Fills the tiles of one volume from its directory and payload.  The
+/// directory has been validated already, so every tile can be filled
+/// independently.
+class voxel_LoadTiles
+{
+public:
+    voxel_LoadTiles(UT_VoxelArrayF *array, const char *dir,
+		    const char *payload)
+	: myArray(array), myDir(dir), myPayload(payload) {}
+
+    void	operator()(const UT_BlockedRange<int> &range) const
+    {
+	for (int i = range.begin(); i < range.end(); i++)
+	{
+	    UT_VoxelTile<float>	*tile = myArray->getLinearTile(i);
+	    const char		*entry = myDir + i * 16;
+	    int32		 type;
+	    fpreal32		 value;
+	    int64		 offset;
+
+	    memcpy(&type, entry, sizeof(type));
+	    memcpy(&value, entry + 4, sizeof(value));
+	    memcpy(&offset, entry + 8, sizeof(offset));
+
+	    if (type == VOXEL_TILE_CONSTANT)
+	    {
+		tile->makeConstant(value);
+	    }
+	    else
+	    {
+		tile->uncompress();
+		memcpy(tile->rawData(), myPayload + offset,
+		       sizeof(fpreal32) * voxelTileSize(tile));
+		tile->tryCompress(myArray->getCompressionOptions());
+	    }
+	}
+    }
+
+private:
+    UT_VoxelArrayF	*myArray;
+    const char		*myDir;
+    const char		*myPayload;
+};
+
+/// Counts the tiles of a voxel array of the given resolution, failing if
+/// the resolution isn't positive or there are more than maxtiles tiles.
+inline bool
+voxelCountTiles(const int32 res[3], exint maxtiles, exint &ntiles)
+{
+    ntiles = 1;
+    for (int axis = 0; axis < 3; axis++)
+    {
+	if (res[axis] <= 0)
+	    return false;
+
+	exint	n = (exint(res[axis]) + TILESIZE-1) / TILESIZE;
+	if (n > maxtiles / ntiles)
+	    return false;
+	ntiles *= n;
+    }
+    return true;
+}
+
+/// Number of voxels in a tile of an array of the given resolution.
+inline exint
+voxelTileSize(const int32 res[3], exint tile)
+{
+    exint	ntx = (exint(res[0]) + TILESIZE-1) / TILESIZE;
+    exint	nty = (exint(res[1]) + TILESIZE-1) / TILESIZE;
+    exint	t[3] = { tile % ntx, (tile / ntx) % nty, tile / (ntx * nty) };
+    exint	voxels = 1;
+
+    for (int axis = 0; axis < 3; axis++)
+	voxels *= SYSmin(exint(TILESIZE), exint(res[axis]) - t[axis]*TILESIZE);
+    return voxels;
+}
+
+/// Loads the volumes of a binary .voxel file, appending the offsets of the
+/// primitives it builds to prims.  Each volume's header and directory are
+/// validated against the file before its primitive is built.
+inline bool
+voxelLoadBinaryVolumes(GU_Detail *gdp, const char *data, exint size,
+		       UT_Array<GA_Offset> &prims)
+{
+    voxel_Reader	r(data, size);
+    char		magic[4];
+    int32		version, tilesize, nvolumes;
+
+    if (!r.read(magic) || memcmp(magic, VOXEL_BINARY_MAGIC, 4))
+	return false;
+    if (!r.read(version) || version != VOXEL_BINARY_VERSION)
+	return false;
+    if (!r.read(tilesize) || tilesize != TILESIZE)
+	return false;
+    if (!r.read(nvolumes))
+	return false;
+
+    GA_RWHandleS name_attrib(gdp->addStringTuple(GA_ATTRIB_PRIMITIVE, "name", 1));
+
+    for (int v = 0; v < nvolumes; v++)
+    {
+	int32		namelen;
+	int32		res[3];
+	fpreal32	center[3], vsize[3];
+	int32		ntiles;
+	int64		payloadsize;
+	exint		expectedtiles;
+
+	if (!r.read(namelen) || namelen < 0 || namelen > r.remaining())
+	    return false;
+
+	UT_String	name;
+	name.harden(r.data(), namelen);
+	if (!r.skip((namelen + 3) & ~3))
+	    return false;
+
+	if (!r.read(res) || !r.read(center) || !r.read(vsize))
+	    return false;
+	if (!r.read(ntiles) || !r.read(payloadsize))
+	    return false;
+
+	// Every tile has a 16 byte directory entry in the file, so a
+	// resolution with more tiles than would fit is corrupt.
+	if (!voxelCountTiles(res, r.remaining() / 16, expectedtiles) ||
+	    ntiles != expectedtiles)
+	    return false;
+
+	const char	*dir = r.data();
+	if (!r.skip(exint(ntiles) * 16))
+	    return false;
+	const char	*payload = r.data();
+	if (payloadsize < 0 || !r.skip(payloadsize))
+	    return false;
+
+	// Validate the directory up front so the tiles can be loaded
+	// in parallel without any error handling.
+	for (int i = 0; i < ntiles; i++)
+	{
+	    int32	type;
+	    int64	offset;
+
+	    memcpy(&type, dir + i * 16, sizeof(type));
+	    memcpy(&offset, dir + i * 16 + 8, sizeof(offset));
+	    if (type == VOXEL_TILE_CONSTANT)
+		continue;
+	    if (type != VOXEL_TILE_RAW)
+		return false;
+
+	    exint	bytes = sizeof(fpreal32) * voxelTileSize(res, i);
+	    if (offset < 0 || offset > payloadsize - bytes)
+		return false;
+	}
+
+	GU_PrimVolume	*vol = voxelBuildVolume(gdp, name_attrib, name,
+						res, center, vsize);
+	UT_VoxelArrayWriteHandleF	handle = vol->getVoxelWriteHandle();
+
+	prims.append(vol->getMapOffset());
+	UT_ASSERT(handle->numTiles() == ntiles);
+
+	UTparallelFor(UT_BlockedRange<int>(0, ntiles),
+		      voxel_LoadTiles(&*handle, dir, payload));
+    }
+
+    return true;
+}
+
+/// Loads a binary .voxel file held in memory, starting at its magic.  If
+/// the file is corrupt, none of its volumes are kept.
+inline bool
+voxelLoadBinary(GU_Detail *gdp, const char *data, exint size)
+{
+    UT_Array<GA_Offset>	prims;
+
+    if (voxelLoadBinaryVolumes(gdp, data, size, prims))
+	return true;
+
+    for (exint i = 0; i < prims.entries(); i++)
+	gdp->destroyPrimitiveOffset(prims(i), true);
+    return false;
+}
+
+/// Loads a binary .voxel file, mapping it into memory.
+inline bool
+voxelLoadBinary(GU_Detail *gdp, const char *fname)
+{
+    voxel_MappedFile	file;
+
+    if (!file.open(fname))
+	return false;
+    return voxelLoadBinary(gdp, file.data(), file.size());
+}
+
+template <typename T>
+inline void
+voxelWrite(std::ostream &os, const T &val)
+{
+    os.write((const char *)&val, sizeof(T));
+}
+
+/// Splits text into whitespace separated tokens.
+class voxel_Scanner
+{
+public:
+    voxel_Scanner(const char *start, const char *end)
+	: myPos(start), myEnd(end) {}
+
+    static bool	isSpace(char c)
+    {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' ||
+	       c == '\f' || c == '\v';
+    }
+
+    /// Returns the next token, or false at the end of the text.
+    bool	token(const char *&start, const char *&end)
+    {
+	while (myPos < myEnd && isSpace(*myPos))
+	    myPos++;
+	if (myPos == myEnd)
+	    return false;
+	start = myPos;
+	while (myPos < myEnd && !isSpace(*myPos))
+	    myPos++;
+	end = myPos;
+	return true;
+    }
+
+    bool	checkToken(const char *expect)
+    {
+	const char	*start, *end;
+
+	if (!token(start, end))
+	    return false;
+	return (exint)strlen(expect) == end - start &&
+	       !strncmp(start, expect, end - start);
+    }
+    bool	getWord(UT_String &word)
+    {
+	const char	*start, *end;
+
+	if (!token(start, end))
+	    return false;
+	word.harden(start, end - start);
+	return true;
+    }
+    bool	getInt(int &val)
+    {
+	const char	*start, *end;
+	char		*stop;
+
+	if (!token(start, end))
+	    return false;
+	long	l = strtol(start, &stop, 10);
+	if (stop != end || l < INT_MIN || l > INT_MAX)
+	    return false;
+	val = (int)l;
+	return true;
+    }
+    bool	getFloat(float &val);
+
+    const char	*pos() const { return myPos; }
+    const char	*end() const { return myEnd; }
+    void	 setPos(const char *pos) { myPos = pos; }
+
+private:
+    const char	*myPos;
+    const char	*myEnd;
+};
+
+/// Parses the float spanning start to end, giving the same result as
+/// strtof.  Plain decimal numbers with up to 15 significant digits and
+/// small exponents have a mantissa and power of ten that are exact in a
+/// double, so a single multiply or divide rounds them correctly to a
+/// double.  Rounding that to a float can only differ from rounding the
+/// decimal directly when the double lands exactly halfway between two
+/// floats.  Those, and anything else, fall back to strtof.
+inline bool
+voxelParseFloat(const char *start, const char *end, float &val)
+{
+    static const double	 pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char		*p = start;
+    bool		 negative = false;
+    uint64		 mantissa = 0;
+    int			 ndigits = 0;
+    int			 exponent = 0;
+    bool		 anydigits = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+	negative = (*p++ == '-');
+
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+	anydigits = true;
+	if (mantissa || *p != '0')
+	{
+	    mantissa = mantissa * 10 + (*p - '0');
+	    ndigits++;
+	}
+    }
+    if (p < end && *p == '.')
+    {
+	for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+	    anydigits = true;
+	    if (mantissa || *p != '0')
+	    {
+		mantissa = mantissa * 10 + (*p - '0');
+		ndigits++;
+	    }
+	    exponent--;
+	}
+    }
+    if (anydigits && p < end && (*p == 'e' || *p == 'E'))
+    {
+	const char	*q = p + 1;
+	bool		 eneg = false;
+	int		 e = 0;
+
+	if (q < end && (*q == '-' || *q == '+'))
+	    eneg = (*q++ == '-');
+	if (q < end && *q >= '0' && *q <= '9')
+	{
+	    for (; q < end && *q >= '0' && *q <= '9'; q++)
+		e = SYSmin(e * 10 + (*q - '0'), 100000);
+	    exponent += eneg ? -e : e;
+	    p = q;
+	}
+    }
+
+    if (anydigits && p == end && ndigits <= 15 &&
+	exponent >= -22 && exponent <= 22)
+    {
+	double		d = (double)mantissa;
+
+	d = exponent < 0 ? d / pow10[-exponent] : d * pow10[exponent];
+
+	float		f = (float)d;
+	bool		tie = false;
+
+	if ((double)f != d)
+	{
+	    float	other = nextafterf(f, d > f ? HUGE_VALF : -HUGE_VALF);
+	    tie = ((double)f + (double)other == 2 * d);
+	}
+	if (!tie)
+	{
+	    val = negative ? -f : f;
+	    return true;
+	}
+    }
+
+    // Long mantissas, huge exponents, ties, inf and nan.
+    char		buf[128];
+    char		*stop;
+
+    if (end - start >= (exint)sizeof(buf))
+	return false;
+    memcpy(buf, start, end - start);
+    buf[end - start] = 0;
+    val = strtof(buf, &stop);
+    return *stop == 0 && stop != buf;
+}
+
+inline bool
+voxel_Scanner::getFloat(float &val)
+{
+    const char	*start, *end;
+
+    if (!token(start, end))
+	return false;
+    return voxelParseFloat(start, end, val);
+}
+
+/// One whitespace aligned piece of a volume's float block.
+struct voxel_TextChunk
+{
+    const char	*myStart;
+    const char	*myEnd;
+    exint	 myFirstVoxel;
+    exint	 myCount;
+    bool	 myError;
+};
+
+/// Counts the tokens of each chunk so we know where each one starts.
+class voxel_CountChunks
+{
+public:
+    voxel_CountChunks(UT_Array<voxel_TextChunk> &chunks)
+	: myChunks(chunks) {}
+
+    void	operator()(const UT_BlockedRange<exint> &range) const
+    {
+	for (exint i = range.begin(); i < range.end(); i++)
+	{
+	    voxel_TextChunk	&chunk = myChunks(i);
+	    exint		 count = 0;
+	    bool		 inspace = true;
+
+	    for (const char *p = chunk.myStart; p < chunk.myEnd; p++)
+	    {
+		bool	space = voxel_Scanner::isSpace(*p);
+
+		if (inspace && !space)
+		    count++;
+		inspace = space;
+	    }
+	    chunk.myCount = count;
+	}
+    }
+
+private:
+    UT_Array<voxel_TextChunk>	&myChunks;
+};
+
+/// Parses each chunk into the raw tiles of the array.  Chunks write to
+/// disjoint voxels, so they can share tiles.
+class voxel_ParseChunks
+{
+public:
+    voxel_ParseChunks(UT_Array<voxel_TextChunk> &chunks, UT_VoxelArrayF *array)
+	: myChunks(chunks), myArray(array) {}
+
+    void	operator()(const UT_BlockedRange<exint> &range) const
+    {
+	int	rx = myArray->getXRes();
+	int	ry = myArray->getYRes();
+
+	for (exint i = range.begin(); i < range.end(); i++)
+	{
+	    voxel_TextChunk	&chunk = myChunks(i);
+	    voxel_Scanner	 scan(chunk.myStart, chunk.myEnd);
+	    exint		 idx = chunk.myFirstVoxel;
+	    int			 x = idx % rx;
+	    int			 y = (idx / rx) % ry;
+	    int			 z = idx / ((exint)rx * ry);
+	    const char		*start, *end;
+
+	    while (scan.token(start, end))
+	    {
+		float		v;
+
+		if (!voxelParseFloat(start, end, v))
+		{
+		    chunk.myError = true;
+		    break;
+		}
+
+		UT_VoxelTile<float>	*tile;
+
+		tile = myArray->getTile(x >> TILEBITS, y >> TILEBITS,
+					z >> TILEBITS);
+		tile->rawData()[((z & TILEMASK) * tile->yres() +
+				(y & TILEMASK)) * tile->xres() +
+				(x & TILEMASK)] = v;
+
+		if (++x == rx)
+		{
+		    x = 0;
+		    if (++y == ry)
+		    {
+			y = 0;
+			z++;
+		    }
+		}
+	    }
+	}
+    }
+
+private:
+    UT_Array<voxel_TextChunk>	&myChunks;
+    UT_VoxelArrayF		*myArray;
+};
+
+/// Expands or compresses every tile of an array.
+class voxel_PrepareTiles
+{
+public:
+    voxel_PrepareTiles(UT_VoxelArrayF *array, bool compress)
+	: myArray(array), myCompress(compress) {}
+
+    void	operator()(const UT_BlockedRange<int> &range) const
+    {
+	for (int i = range.begin(); i < range.end(); i++)
+	{
+	    UT_VoxelTile<float>	*tile = myArray->getLinearTile(i);
+
+	    if (myCompress)
+		tile->tryCompress(myArray->getCompressionOptions());
+	    else
+		tile->uncompress();
+	}
+    }
+
+private:
+    UT_VoxelArrayF	*myArray;
+    bool		 myCompress;
+};
+
+/// Loads the float block spanning start to end into array.
+inline bool
+voxelParseBlock(UT_VoxelArrayF *array, const char *start, const char *end)
+{
+    const exint		chunksize = 1 << 20;
+    UT_Array<voxel_TextChunk>	chunks;
+
+    // Cut the block roughly every chunksize bytes, moving each cut
+    // forward to whitespace so no token is split.
+    for (const char *p = start; p < end; )
+    {
+	const char	*cut = (end - p > chunksize) ? p + chunksize : end;
+
+	while (cut < end && !voxel_Scanner::isSpace(*cut))
+	    cut++;
+
+	voxel_TextChunk	chunk;
+	chunk.myStart = p;
+	chunk.myEnd = cut;
+	chunk.myFirstVoxel = 0;
+	chunk.myCount = 0;
+	chunk.myError = false;
+	chunks.append(chunk);
+	p = cut;
+    }
+
+    UTparallelFor(UT_BlockedRange<exint>(0, chunks.entries()),
+		  voxel_CountChunks(chunks));
+
+    exint		total = 0;
+    for (exint i = 0; i < chunks.entries(); i++)
+    {
+	chunks(i).myFirstVoxel = total;
+	total += chunks(i).myCount;
+    }
+    if (total != exint(array->getXRes()) * array->getYRes() * array->getZRes())
+	return false;
+
+    UTparallelFor(UT_BlockedRange<int>(0, array->numTiles()),
+		  voxel_PrepareTiles(array, false));
+    UTparallelFor(UT_BlockedRange<exint>(0, chunks.entries()),
+		  voxel_ParseChunks(chunks, array));
+    UTparallelFor(UT_BlockedRange<int>(0, array->numTiles()),
+		  voxel_PrepareTiles(array, true));
+
+    for (exint i = 0; i < chunks.entries(); i++)
+    {
+	if (chunks(i).myError)
+	    return false;
+    }
+    return true;
+}
+
+/// Loads the volumes of an ascii .voxel file held in memory, appending
+/// the offsets of the primitives it builds to prims.  Each volume's
+/// resolution is checked against the size of its float block before its
+/// primitive is built.
+inline bool
+voxelLoadAsciiVolumes(GU_Detail *gdp, const char *data, exint size,
+		      UT_Array<GA_Offset> &prims)
+{
+    voxel_Scanner	scan(data, data + size);
+
+    // Check our magic token
+    if (!scan.checkToken("VOXELS"))
+	return false;
+
+    GA_RWHandleS name_attrib(gdp->addStringTuple(GA_ATTRIB_PRIMITIVE, "name", 1));
+
+    while (scan.checkToken("VOLUME"))
+    {
+	UT_String	name;
+	int		res[3];
+	float		center[3], vsize[3];
+
+	if (!scan.getWord(name))
+	    return false;
+	if (!scan.getInt(res[0]) || !scan.getInt(res[1]) ||
+	    !scan.getInt(res[2]))
+	    return false;
+
+	// Center and size
+	for (int i = 0; i < 3; i++)
+	    if (!scan.getFloat(center[i]))
+		return false;
+	for (int i = 0; i < 3; i++)
+	    if (!scan.getFloat(vsize[i]))
+		return false;
+
+	if (!scan.checkToken("{"))
+	    return false;
+
+	// Floats never contain a brace, so the block runs up to the
+	// next one.
+	const char	*start = scan.pos();
+	const char	*end = (const char *)memchr(start, '}',
+						    scan.end() - start);
+	if (!end)
+	    return false;
+
+	// Every voxel takes at least one digit and one space, so a
+	// resolution with more voxels than would fit in the block is
+	// corrupt.  Bounding the tiles first keeps the product from
+	// overflowing.
+	exint		maxvoxels = (end - start + 1) / 2;
+	exint		ntiles;
+
+	if (!voxelCountTiles(res, maxvoxels, ntiles) ||
+	    exint(res[0]) * res[1] * res[2] > maxvoxels)
+	    return false;
+
+	GU_PrimVolume	*vol = voxelBuildVolume(gdp, name_attrib, name,
+						res, center, vsize);
+	UT_VoxelArrayWriteHandleF	handle = vol->getVoxelWriteHandle();
+
+	prims.append(vol->getMapOffset());
+
+	if (!voxelParseBlock(&*handle, start, end))
+	    return false;
+
+	scan.setPos(end);
+	if (!scan.checkToken("}"))
+	    return false;
+
+	// Proceed to the next volume.
+    }
+
+    // All done successfully
+    return true;
+}
+
+/// Loads an ascii .voxel file held in memory.  If the file is corrupt,
+/// none of its volumes are kept.
+inline bool
+voxelLoadAscii(GU_Detail *gdp, const char *data, exint size)
+{
+    UT_Array<GA_Offset>	prims;
+
+    if (voxelLoadAsciiVolumes(gdp, data, size, prims))
+	return true;
+
+    for (exint i = 0; i < prims.entries(); i++)
+	gdp->destroyPrimitiveOffset(prims(i), true);
+    return false;
+}
+
+/// Loads a .voxel file of either form held in memory.
+inline bool
+voxelLoad(GU_Detail *gdp, const char *data, exint size)
+{
+    if (size >= 4 && !memcmp(data, VOXEL_BINARY_MAGIC, 4))
+	return voxelLoadBinary(gdp, data, size);
+    return voxelLoadAscii(gdp, data, size);
+}
+
+/// Writes all the volumes of gdp as a binary .voxel file.
+inline bool
+voxelSaveBinary(std::ostream &os, const GEO_Detail *gdp)
+{
+    GA_ROHandleS	name_attrib(gdp->findPrimitiveAttribute("name"));
+    UT_Array<const GEO_PrimVolume *> volumes;
+    const GEO_Primitive	*prim;
+
+    GA_FOR_ALL_PRIMITIVES(gdp, prim)
+    {
+	if (prim->getTypeId() == GEO_PRIMVOLUME)
+	    volumes.append((const GEO_PrimVolume *)prim);
+    }
+
+    os.write(VOXEL_BINARY_MAGIC, 4);
+    voxelWrite(os, int32(VOXEL_BINARY_VERSION));
+    voxelWrite(os, int32(TILESIZE));
+    voxelWrite(os, int32(volumes.entries()));
+
+    UT_WorkBuffer	buf;
+    UT_FloatArray	scratch;
+
+    for (exint v = 0; v < volumes.entries(); v++)
+    {
+	const GEO_PrimVolume	*vol = volumes(v);
+
+	// Default name, which is overridden by any name attribute.
+	buf.sprintf("volume_%" SYS_PRId64, (exint)vol->getMapIndex());
+	UT_String	name;
+	name.harden(buf.buffer());
+	if (name_attrib.isValid())
+	    name = name_attrib.get(vol->getMapOffset());
+
+	int32		namelen = name.length();
+	static const char zeros[4] = { 0, 0, 0, 0 };
+
+	voxelWrite(os, namelen);
+	os.write(name.buffer() ? name.buffer() : "", namelen);
+	os.write(zeros, ((namelen + 3) & ~3) - namelen);
+
+	// Save the resolution, center and approximate size as the
+	// ascii format does, which likewise loses any rotation or
+	// shear.
+	int		resx, resy, resz;
+	UT_Vector3	p1, p2;
+
+	vol->getRes(resx, resy, resz);
+	voxelWrite(os, int32(resx));
+	voxelWrite(os, int32(resy));
+	voxelWrite(os, int32(resz));
+
+	UT_Vector3	center = vol->getPos3(0);
+	voxelWrite(os, fpreal32(center.x()));
+	voxelWrite(os, fpreal32(center.y()));
+	voxelWrite(os, fpreal32(center.z()));
+
+	vol->indexToPos(0, 0, 0, p1);
+	vol->indexToPos(1, 0, 0, p2);
+	fpreal32	length = (p1 - p2).length();
+	voxelWrite(os, fpreal32(resx * length));
+	voxelWrite(os, fpreal32(resy * length));
+	voxelWrite(os, fpreal32(resz * length));
+
+	UT_VoxelArrayReadHandleF handle = vol->getVoxelHandle();
+	int		ntiles = handle->numTiles();
+	int64		payloadsize = 0;
+
+	// The directory comes first, so lay out the payload before
+	// writing anything.
+	for (int i = 0; i < ntiles; i++)
+	{
+	    const UT_VoxelTile<float>	*tile = handle->getLinearTile(i);
+
+	    if (!tile->isConstant())
+		payloadsize += sizeof(fpreal32) * voxelTileSize(tile);
+	}
+	voxelWrite(os, int32(ntiles));
+	voxelWrite(os, payloadsize);
+
+	int64		offset = 0;
+	for (int i = 0; i < ntiles; i++)
+	{
+	    const UT_VoxelTile<float>	*tile = handle->getLinearTile(i);
+
+	    if (tile->isConstant())
+	    {
+		voxelWrite(os, int32(VOXEL_TILE_CONSTANT));
+		voxelWrite(os, fpreal32((*tile)(0, 0, 0)));
+		voxelWrite(os, int64(0));
+	    }
+	    else
+	    {
+		voxelWrite(os, int32(VOXEL_TILE_RAW));
+		voxelWrite(os, fpreal32(0));
+		voxelWrite(os, offset);
+		offset += sizeof(fpreal32) * voxelTileSize(tile);
+	    }
+	}
+
+	for (int i = 0; i < ntiles; i++)
+	{
+	    const UT_VoxelTile<float>	*tile = handle->getLinearTile(i);
+
+	    if (tile->isConstant())
+		continue;
+
+	    if (tile->isRaw())
+	    {
+		os.write((const char *)tile->rawData(),
+			 sizeof(fpreal32) * voxelTileSize(tile));
+		continue;
+	    }
+
+	    // Compressed tiles are decoded into a scratch buffer.
+	    scratch.setSize(voxelTileSize(tile));
+	    exint	idx = 0;
+	    for (int z = 0; z < tile->zres(); z++)
+		for (int y = 0; y < tile->yres(); y++)
+		    for (int x = 0; x < tile->xres(); x++)
+			scratch(idx++) = (*tile)(x, y, z);
+	    os.write((const char *)scratch.array(),
+		     sizeof(fpreal32) * scratch.entries());
+	}
+    }
+
+    return !os.fail();
+}
+
+}
+
+#endif
@@ -38,10 +38,14 @@
 #ifndef __SNOW_Solver_h__
 #define __SNOW_Solver_h__
 
+#include <UT/UT_Array.h>
 #include <UT/UT_HashTable.h>
 #include <UT/UT_Hash.h>
 #include <UT/UT_IStream.h>
+#include <UT/UT_IntArray.h>
 #include <UT/UT_Map.h>
+#include <UT/UT_ThreadedAlgorithm.h>
+#include <UT/UT_ValArray.h>
 #include <UT/UT_VoxelArray.h>
 #include <GA/GA_Types.h>
 #include <GU/GU_DetailHandle.h>
@@ -51,15 +55,19 @@
 
 #define SIM_NAME_BIRTHRATE	"birthrate"
 #define SIM_NAME_ORIGINALDEPTH	"originaldepth"
+#define SIM_NAME_PARALLELSOLVE	"parallelsolve"
 
 class SIM_Object;
 class SIM_Random;
+class GU_RayIntersect;
 
 typedef unsigned char		u8;
 
 namespace HDK_Sample {
 
 class SNOW_VoxelArray;
+class snow_ColliderCache;
+class snow_ColliderRows;
 
 // This class implemented a computational fluid dynamics solver.
 class SNOW_Solver : public SIM_SingleSolver,
@@ -69,6 +77,7 @@ public:
     // Access methods for our configuration data.
     GETSET_DATA_FUNCS_F(SIM_NAME_BIRTHRATE, BirthRate);
     GETSET_DATA_FUNCS_I(SIM_NAME_ORIGINALDEPTH, OriginalDepth);
+    GETSET_DATA_FUNCS_B(SIM_NAME_PARALLELSOLVE, ParallelSolve);
     
 protected:
     explicit		 SNOW_Solver(const SIM_DataFactory *factory);
@@ -106,6 +115,24 @@ protected:
 				u8 voxletype,
 				SIM_Random *rand) const;
 
+    // Returns a ray intersect cache for the given geometry.  Rays are
+    // cast in the space of the geometry, so a collider that only moves
+    // keeps its cache; it is only rebuilt when the detail or its
+    // point positions or topology change.
+    GU_RayIntersect	*findRayIntersect(const GU_ConstDetailHandle &gdh,
+				const GU_Detail *gdp) const;
+    // Drops cached ray intersects that have not been used for a while.
+    void		 pruneRayIntersects() const;
+
+    // Casts the rays of all rows of a collider and records the spans
+    // that are inside it.  Only reads the collider, so the rows are
+    // cast in parallel and applied to the array serially afterwards.
+    THREADED_METHOD1_CONST(SNOW_Solver, true,
+				castRows,
+				snow_ColliderRows *, rows);
+    void		 castRowsPartial(snow_ColliderRows *rows,
+				const UT_JobInfo &info) const;
+
 private:
     static const SIM_DopDescription	*getSolverSNOWDopDescription();
 
@@ -115,6 +142,37 @@ private:
     void		 setVoxelArrayAttributes(
 					SNOW_VoxelArray *voxelarray) const;
 
+    // Moves the snow at level z down to z-1 for all voxels in the
+    // [xmin,xmax) x [ymin,ymax) columns.  Exactly one of rand or seed
+    // should be given: the serial solve draws from the object's
+    // SIM_Random, the tiled solve from a private per-tile stream.
+    void		 settleRange(SNOW_VoxelArray &snow, int z,
+				int xmin, int xmax, int ymin, int ymax,
+				SIM_Random *rand, uint *seed) const;
+
+    // Settles one z level by splitting it into TILESIZE x TILESIZE
+    // column tiles.  A tile only touches voxels within one voxel of
+    // itself, so tiles three apart in x and y can never interfere.
+    // We run the nine resulting phases one after another and the tiles
+    // of a phase in parallel.  Every tile seeds its own random stream
+    // from (seed, z, tile), so the result does not depend on the
+    // number of threads.
+    void		 settleLevelTiled(SNOW_VoxelArray &snow, int z,
+				uint seed) const;
+    THREADED_METHOD4_CONST(SNOW_Solver, true,
+				settleTiles,
+				SNOW_VoxelArray *, snow,
+				int, z,
+				int, phase,
+				uint, seed);
+    void		 settleTilesPartial(SNOW_VoxelArray *snow,
+				int z, int phase, uint seed,
+				const UT_JobInfo &info) const;
+
+    // Ray intersect caches keyed by the unique id of their detail.
+    mutable UT_Map<exint, snow_ColliderCache *>	 myColliderCache;
+    mutable exint				 mySolveCount;
+
     DECLARE_STANDARD_GETCASTTOTYPE();
     DECLARE_DATAFACTORY(SNOW_Solver,
 			SIM_SingleSolver,
@@ -129,10 +187,132 @@ private:
 #define VOXEL_WALL		3
 #define VOXEL_OBJECT		4
 
+// Per-tile flags kept by SNOW_VoxelArray:
+#define SNOW_TILE_DIRTY		0x01	// A voxel changed during this step
+#define SNOW_TILE_WASDIRTY	0x02	// A voxel changed during the last step
+#define SNOW_TILE_OBJECT	0x04	// VOXEL_OBJECT was written here
+#define SNOW_TILE_MESHDIRTY	0x08	// Changed since its quads were built
+
 #define SNOW_NAME_DIVISIONS	"div"
 #define SNOW_NAME_CENTER	"t"
 #define SNOW_NAME_SIZE		"size"
 
+// A quad of the extracted snow surface, given as the voxel lattice
+// coordinates of its four corners in winding order.
+class SNOW_Quad
+{
+public:
+    int			 myCorner[4][3];
+};
+typedef UT_Array<SNOW_Quad>	SNOW_QuadList;
+
+// A TILESIZE^3 tile of snow states.  Settled snow tiles rarely hold
+// more than two states, so instead of a byte per voxel a tile keeps a
+// small palette of the states it holds and packs the palette indices
+// into 1, 2 or 4 bits per voxel.  Tiles of a single state are stored
+// as just that state.  A tile that is being written to is expanded to
+// a raw byte per voxel until compress() packs it again.
+class SNOW_PackedTile
+{
+public:
+		 SNOW_PackedTile();
+
+    void	 init(int xres, int yres, int zres, u8 value);
+
+    int		 xres() const { return myRes[0]; }
+    int		 yres() const { return myRes[1]; }
+    int		 zres() const { return myRes[2]; }
+    int		 numVoxels() const { return myRes[0] * myRes[1] * myRes[2]; }
+
+    bool	 isConstant() const { return myBits == 0; }
+    bool	 isRaw() const { return myBits == 8; }
+    u8		 getConstantValue() const { return myConstant; }
+
+    // Looks up a voxel by its linear index within the tile.
+    u8		 getValue(int idx) const
+		 {
+		     if (myBits == 0)
+			 return myConstant;
+		     if (myBits == 8)
+			 return myData(idx);
+		     int bit = idx * myBits;
+		     return myPalette[(myData(bit >> 3) >> (bit & 7)) &
+				      ((1 << myBits) - 1)];
+		 }
+    u8		 operator()(int x, int y, int z) const
+		 { return getValue((z * myRes[1] + y) * myRes[0] + x); }
+
+    // Copies the voxels [x, x+n) of the given row into dst.
+    void	 getRow(u8 *dst, int x, int n, int y, int z) const;
+
+    void	 makeConstant(u8 value);
+    // Expands the tile to one byte per voxel, in x, then y, then z
+    // order, and returns those bytes for writing.
+    u8		*makeRaw();
+    // Packs a raw tile as tightly as its states allow.
+    void	 compress();
+
+    int64	 getMemoryUsage(bool inclusive) const;
+
+private:
+    UT_ValArray<u8>	 myData;
+    int			 myRes[3];
+    // Bits per voxel: 0 for constant tiles, 8 for raw ones.
+    u8			 myBits;
+    u8			 myConstant;
+    u8			 myPalette[16];
+};
+
+// The voxels of a SNOW_VoxelArray, stored as SNOW_PackedTiles.  Voxels
+// outside of the array read as VOXEL_WALL.
+class SNOW_PackedArray
+{
+public:
+		 SNOW_PackedArray();
+
+    // Resizes the array and fills it with VOXEL_EMPTY.
+    void	 size(int xres, int yres, int zres);
+
+    int		 getXRes() const { return myRes[0]; }
+    int		 getYRes() const { return myRes[1]; }
+    int		 getZRes() const { return myRes[2]; }
+    int		 getTileRes(int axis) const { return myTileRes[axis]; }
+    int		 numTiles() const { return myTiles.entries(); }
+
+    bool	 isValidIndex(int x, int y, int z) const
+		 {
+		     return x >= 0 && x < myRes[0] &&
+			    y >= 0 && y < myRes[1] &&
+			    z >= 0 && z < myRes[2];
+		 }
+
+    SNOW_PackedTile		*getTile(int tx, int ty, int tz)
+		 { return &myTiles((tz * myTileRes[1] + ty) * myTileRes[0] + tx); }
+    const SNOW_PackedTile	*getTile(int tx, int ty, int tz) const
+		 { return &myTiles((tz * myTileRes[1] + ty) * myTileRes[0] + tx); }
+
+    u8		 getValue(int x, int y, int z) const
+		 {
+		     if (!isValidIndex(x, y, z))
+			 return VOXEL_WALL;
+		     return (*getTile(x >> TILEBITS, y >> TILEBITS,
+				      z >> TILEBITS))(x & TILEMASK,
+						      y & TILEMASK,
+						      z & TILEMASK);
+		 }
+    void	 setValue(int x, int y, int z, u8 voxel);
+
+    // Packs all the tiles that were expanded for writing.
+    void	 collapseAllTiles();
+
+    int64	 getMemoryUsage(bool inclusive) const;
+
+private:
+    UT_Array<SNOW_PackedTile>	 myTiles;
+    int				 myRes[3];
+    int				 myTileRes[3];
+};
+
 // This class hold an oriented bounding box tree.
 class SNOW_VoxelArray : public SIM_Geometry
 			// SIM_Geometry already mixes this in.
@@ -147,6 +327,46 @@ public:
     u8			 getVoxel(int x, int y, int z) const;
     void		 setVoxel(u8 voxel, int x, int y, int z);
 
+    // Fills every voxel in the levels [zmin, zmax) with the given
+    // value.  Tiles that are entirely covered are made constant.
+    void		 fillLevels(u8 voxel, int zmin, int zmax);
+
+    // Tile level access.  Like getVoxel(), these allocate the array
+    // on demand, so call getArray() once before going multithreaded.
+    const SNOW_PackedArray &getArray() const;
+    SNOW_PackedArray	&getArrayNC();
+    // Returns true if the given tile holds a single value, which is
+    // then stored in voxel.  Out of range tiles are constant walls.
+    bool		 isTileConstant(int tx, int ty, int tz,
+					u8 &voxel) const;
+
+    // Active tile tracking.  Any write that changes a voxel flags its
+    // tile as dirty.  advanceActiveTiles() starts a new step and keeps
+    // the tiles dirtied during the previous step active, so a tile is
+    // only skipped once its neighbourhood has been still for a full
+    // step.  Note a collider that is re-rasterised every step keeps the
+    // tiles it covers active even if it does not move.
+    void		 advanceActiveTiles();
+    void		 markAllTilesActive();
+    bool		 isTileActive(int tx, int ty, int tz) const;
+    // True if any of the 3x3 tiles around (tx, ty) at level tz are
+    // active.
+    bool		 isNeighbourhoodActive(int tx, int ty, int tz) const;
+    bool		 isLevelActive(int tz) const;
+    void		 markVoxelChanged(int x, int y, int z, u8 voxel)
+			 {
+			     u8 &flags = myTileFlags(tileIndex(x >> TILEBITS,
+							       y >> TILEBITS,
+							       z >> TILEBITS));
+			     flags |= SNOW_TILE_DIRTY | SNOW_TILE_MESHDIRTY;
+			     if (voxel == VOXEL_OBJECT)
+				 flags |= SNOW_TILE_OBJECT;
+			 }
+
+    // Resets all VOXEL_OBJECT voxels to VOXEL_EMPTY.  Only the tiles
+    // objects were written to since the last call are visited.
+    void		 clearObjectVoxels();
+
     void		 collapseAllTiles();
 
     void		 pubHandleModification()
@@ -176,20 +396,45 @@ protected:
 private:
     static const SIM_DopDescription	*getVoxelArrayDopDescription();
 
-    GA_Offset		 createOrFindPoint(GU_Detail *gdp, int x, int y, int z);
-    void		 buildFace(GU_Detail *gdp,
-				   int x0, int y0, int z0,
-				   int x1, int y1, int z1,
-				   int x2, int y2, int z2,
-				   int x3, int y3, int z3);
+    // Reads the voxels between the braces written by saveSubclass().
+    // Returns false unless the file holds exactly one valid state for
+    // every voxel.
+    bool		 loadVoxels(UT_IStream &is, bool rle);
+
+    // Surface extraction.  Each tile is meshed on its own: for every
+    // face direction we sweep the slices of the tile, mark the exposed
+    // snow faces and greedily merge them into the largest rectangles
+    // we can find.  Quads never cross a tile boundary.
+    void		 extractTileQuads(int tx, int ty, int tz,
+					  SNOW_QuadList &quads) const;
+    // Re-extracts the quads of the listed tiles into myTileQuads.
+    THREADED_METHOD1_CONST(SNOW_VoxelArray, tiles->entries() > 1,
+				extractTiles,
+				const UT_IntArray *, tiles);
+    void		 extractTilesPartial(const UT_IntArray *tiles,
+				const UT_JobInfo &info) const;
+    // A tile's quads depend on the voxels of its six neighbours, so it
+    // is stale if it or any of them changed since the last build.
+    bool		 isTileMeshStale(int tx, int ty, int tz) const;
     void		 buildGeometryFromArray();
     void		 freeArray() const;
     void		 allocateArray() const;
+    int			 tileIndex(int tx, int ty, int tz) const
+			 {
+			     return (tz * myVoxelArray->getTileRes(1) + ty)
+				    * myVoxelArray->getTileRes(0) + tx;
+			 }
 
     mutable GU_DetailHandle		 myDetailHandle;
-    mutable UT_VoxelArray<u8>		*myVoxelArray;
-
-    UT_Map<exint, GA_Offset>		 myPointHash;
+    mutable SNOW_PackedArray		*myVoxelArray;
+    // One byte of SNOW_TILE_* flags per tile of myVoxelArray.  Bytes
+    // rather than bits so that threads working on different tiles can
+    // update their flags without locking.
+    mutable UT_ValArray<u8>		 myTileFlags;
+    // The quads extracted for each tile during the last geometry build.
+    // These are carried over by makeEqual(), so each new step only has
+    // to re-extract the tiles that changed.
+    mutable UT_Array<SNOW_QuadList>	 myTileQuads;
 
     DECLARE_STANDARD_GETCASTTOTYPE();
     DECLARE_DATAFACTORY(SNOW_VoxelArray,	// Our Classname
@@ -199,6 +444,66 @@ private:
 			);
 };
 
+// A read-only view of one z level of a SNOW_VoxelArray over the columns
+// [xmin,xmax) x [ymin,ymax), grown by pad voxels on each side.  The
+// voxels are copied out a tile row at a time, so neighbourhood lookups
+// are plain array reads rather than getVoxel() calls.  Out of bound
+// voxels read as VOXEL_WALL, just like getVoxel().
+class SNOW_SlabView
+{
+public:
+		 SNOW_SlabView();
+
+    void	 load(const SNOW_VoxelArray &snow, int z,
+		      int xmin, int xmax, int ymin, int ymax, int pad);
+
+    // Coordinates are absolute voxel indices.
+    u8		 operator()(int x, int y) const
+		 { return myData((y - myYMin) * myXRes + (x - myXMin)); }
+
+    // Updates the cached copy only, the matching change must be written
+    // to the array separately, usually through a SNOW_TileCursor.
+    void	 set(int x, int y, u8 voxel)
+		 {
+		     myData((y - myYMin) * myXRes + (x - myXMin)) = voxel;
+		     if (voxel != myConstantValue)
+			 myIsConstant = false;
+		 }
+
+    // True if every voxel of the view, including the padding, was
+    // read from constant tiles of the same value.
+    bool	 isConstant() const { return myIsConstant; }
+    u8		 getConstantValue() const { return myConstantValue; }
+
+private:
+    UT_ValArray<u8>	 myData;
+    int			 myXMin, myYMin;
+    int			 myXRes, myYRes;
+    bool		 myIsConstant;
+    u8			 myConstantValue;
+};
+
+// A writable cursor over the tiles of a SNOW_VoxelArray.  The tile of
+// the last write is kept uncompressed and written to directly, so runs
+// of writes into one tile skip the lookup and decompression done by
+// setVoxel().  Writes that don't change a voxel leave its tile packed.
+// A cursor must not be shared between threads, and two cursors must not
+// write to the same tile at the same time.
+class SNOW_TileCursor
+{
+public:
+    explicit	 SNOW_TileCursor(SNOW_VoxelArray &snow);
+
+    void	 setVoxel(u8 voxel, int x, int y, int z);
+
+private:
+    SNOW_VoxelArray	*mySnow;
+    SNOW_PackedArray	*myArray;
+    SNOW_PackedTile	*myTile;
+    u8			*myData;
+    int			 myTX, myTY, myTZ;
+};
+
 // This class hold an oriented bounding box tree.
 class SNOW_Visualize : public SIM_Data,
 			public SIM_OptionsUser
@@ -207,6 +512,7 @@ public:
     GET_GUIDE_FUNC_B(SIM_NAME_SHOWGUIDE, ShowGuide, true);
     GET_GUIDE_FUNC_V3(SIM_NAME_COLOR, Color, (1, 1, 1));
     GET_GUIDE_FUNC_B("usebox", UseBox, false);
+    GET_GUIDE_FUNC_B("usesurface", UseSurface, false);
 
 protected:
     explicit		 SNOW_Visualize(const SIM_DataFactory *factory);
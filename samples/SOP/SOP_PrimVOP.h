@@ -29,6 +29,7 @@
 #define __SOP_PrimVOP__
 
 #include <SOP/SOP_Node.h>
+#include <UT/UT_ThreadedAlgorithm.h>
 #include <CVEX/CVEX_Value.h>
 #include <VOP/VOP_CodeGenerator.h>
 #include <VOP/VOP_ExportedParmsManager.h>
@@ -38,6 +39,9 @@ class CVEX_Context;
 class OP_Caller;
 
 namespace HDK_Sample {
+class sop_PrimVexBlock;
+class sop_PrimVexJob;
+
 class SOP_PrimVOP : public SOP_Node
 {
 public:
@@ -68,11 +72,27 @@ protected:
     void		 executeVex(int argc, char **argv,
 				fpreal t, OP_Caller &opcaller);
 
+    /// Runs the primitives in blocks on all threads.  The results are
+    /// kept with their block and written to the detail in primitive
+    /// order once every block is done, so they match the serial run.
+    void		 executeVexThreaded(int argc, char **argv,
+				fpreal t, OP_Caller &opcaller);
+    THREADED_METHOD2(SOP_PrimVOP, nblocks > 1,
+				processVexBlocks,
+				int, nblocks,
+				sop_PrimVexJob *, job);
+    void		 processVexBlocksPartial(int nblocks,
+				sop_PrimVexJob *job,
+				const UT_JobInfo &info);
+
+    /// Runs VEX over one block.  This only reads the detail, the
+    /// results are copied to it by writeVexBlock().
     void		 processVexBlock(CVEX_Context &context,
 				    CVEX_RunData &rundata,
 				    int argc, char **argv,
-				    int *primid, int n,
+				    sop_PrimVexBlock &block,
 				    fpreal t);
+    void		 writeVexBlock(sop_PrimVexBlock &block);
 
     int			 VEXSRC(fpreal t)
 			 { return evalInt("vexsrc", 0, t); }
@@ -81,6 +101,8 @@ protected:
 
     void		 SHOPPATH(UT_String &path, fpreal t)
 			 { evalString(path, "shoppath", 0, t); }
+    int			 THREADED(fpreal t)
+			 { return evalInt("threaded", 0, t); }
 
     /// VOP and VEX functions
     virtual void	 finishedLoadingNetwork(bool is_child_call=false);
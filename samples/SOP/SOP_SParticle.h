@@ -32,6 +32,7 @@
 #define __SOP_SParticle_h__
 
 #include <SOP/SOP_Node.h>
+#include <UT/UT_FloatArray.h>
 
 #define INT_PARM(name, idx, vidx, t)	\
 	    return evalInt(name, &myOffsets[idx], vidx, t);
@@ -39,8 +40,6 @@
 #define FLT_PARM(name, idx, vidx, t)	\
 	    return evalFloat(name, &myOffsets[idx], vidx, t);
 
-class GEO_ParticleVertex;
-class GEO_PrimParticle;
 class GU_RayIntersect;
 
 namespace HDK_Sample {
@@ -58,11 +57,16 @@ protected:
     virtual const char          *inputLabel(unsigned idx) const;
 
     void		birthParticle();
-    int			moveParticle(GA_Offset ptoff,
-				     const UT_Vector3 &force);
+
+    // Makes myCollision intersect the given geometry, reusing the
+    // one from the last cook if the geometry hasn't changed.
+    void		updateCollision(const GU_Detail *collision);
 
     void		initSystem();
     void		timeStep(fpreal now);
+    // Replaces our geometry with a particle system holding the
+    // simulated particles.
+    void		buildGeometry();
 
     // Method to cook geometry for the SOP
     virtual OP_ERROR		 cookMySop(OP_Context &context);
@@ -77,17 +81,27 @@ private:
     fpreal		 FX(fpreal t)	{ FLT_PARM("force", 1, 0, t) }
     fpreal		 FY(fpreal t)	{ FLT_PARM("force", 1, 1, t) }
     fpreal		 FZ(fpreal t)	{ FLT_PARM("force", 1, 2, t) }
+    int			 SUBSTEPS(fpreal t){ INT_PARM("substeps", 3, 0, t) }
 
     const GU_Detail	*mySource;
     GA_Index		 mySourceNum;		// Source point to birth from
     GA_ROHandleV3	 mySourceVel;		// Velocity attrib in source
 
     GU_RayIntersect	*myCollision;
-
-    GEO_PrimParticle	*mySystem;
+    exint		 myCollisionId;		// Unique id of its detail
+    int64		 myCollisionMetaCount;
+    GA_DataId		 myCollisionPId;
+    GA_DataId		 myCollisionPrimListId;
+
+    // The particles are simulated in these arrays, in the order they
+    // were born, and only copied to the detail at the end of a cook.
+    UT_FloatArray	 myPos[3];
+    UT_FloatArray	 myVel[3];
+    UT_FloatArray	 myAge;			// Frames lived so far
+    UT_FloatArray	 myLife;		// Frames to live
+    exint		 myBirthCount;		// Seeds the next birth
+    bool		 myInitialized;
     fpreal		 myLastCookTime;	// Last cooked time
-    GA_RWHandleV3	 myVelocity;		// My velocity attribute
-    GA_RWHandleF	 myLife;		// My life attribute
 
     static int		*myOffsets;
 };
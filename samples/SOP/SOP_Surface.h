@@ -53,6 +53,7 @@ protected:
 private:
     fpreal  ISO(fpreal t)   { return evalFloat("iso", 0, t); }
     bool BUILDPOLYSOUP(fpreal t) { return evalInt("buildpolysoup", 0, t) != 0; }
+    bool PARALLELTILES(fpreal t) { return evalInt("paralleltiles", 0, t) != 0; }
 };
 } // End HDK_Sample namespace
 
@@ -33,6 +33,8 @@
 #include <SOP/SOP_Node.h>
 
 namespace HDK_Sample {
+class sop_CompareSource;
+
 /// Compares a point attribute on the two inputs at different times, storing
 /// the difference in a new attribute.
 class SOP_TimeCompare : public SOP_Node
@@ -51,6 +53,10 @@ public:
     virtual OP_ERROR		 cookInputGroups(OP_Context &context, 
 						int alone = 0);
 
+    /// Drops the cached second input geometry.
+    static int			 onReload(void *data, int index, fpreal t,
+					  const PRM_Template *tplate);
+
 protected:
     /// Method to cook geometry for the SOP
     virtual OP_ERROR		 cookMySop(OP_Context &context);
@@ -64,10 +70,21 @@ private:
 		{ evalString(str, "resultattrib", 0, t); }
     fpreal	FRAME(fpreal t)
 		{ return evalFloat("frame", 0, t); }
+    int		MATCHBY(fpreal t)
+		{ return evalInt("matchby", 0, t); }
+    void	IDATTRIB(UT_String &str, fpreal t)
+		{ evalString(str, "idattrib", 0, t); }
+    bool	CACHESECOND(fpreal t)
+		{ return evalInt("cachesecond", 0, t) != 0; }
 
     /// This is the group of geometry to be manipulated by this SOP and cooked
     /// by the method "cookInputGroups".
     const GA_PointGroup *myGroup;
+
+    /// The second input's geometry at the comparison frame.  If the
+    /// second input is cached, this is a copy that is kept until the
+    /// comparison frame changes.
+    sop_CompareSource	*mySource;
 };
 } // End HDK_Sample namespace
 
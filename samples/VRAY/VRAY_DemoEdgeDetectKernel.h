@@ -0,0 +1,688 @@
+/*
+ * Copyright (c) 2015
+ *	Side Effects Software Inc.  All rights reserved.
+ *
+ * Redistribution and use of Houdini Development Kit samples in source and
+ * binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. The name of Side Effects Software may not be used to endorse or
+ *    promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIDE EFFECTS SOFTWARE `AS IS' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN
+ * NO EVENT SHALL SIDE EFFECTS SOFTWARE BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *----------------------------------------------------------------------------
+ * The edge detection used by VRAY_DemoEdgeDetectFilter, on plain sample
+ * buffers, so that it can be run outside of mantra.
+ */
+
+#pragma once
+
+#ifndef __VRAY_DemoEdgeDetectKernel__
+#define __VRAY_DemoEdgeDetectKernel__
+
+#include <UT/UT_Array.h>
+#include <UT/UT_Assert.h>
+#include <UT/UT_ParallelUtil.h>
+#include <UT/UT_StackBuffer.h>
+#include <SYS/SYS_Floor.h>
+#include <SYS/SYS_Math.h>
+#include <VM/VM_SIMD.h>
+
+#include <string.h>
+
+namespace HDK_Sample {
+
+/// The settings of the edge detection, as prepared by
+/// VRAY_DemoEdgeDetectFilter::prepFilter().
+class VRAY_DemoEdgeDetectParms {
+public:
+    /// Each pixel has mySamplesPerPixelX*mySamplesPerPixelY samples.
+    /// @{
+    int mySamplesPerPixelX;
+    int mySamplesPerPixelY;
+    /// @}
+
+    /// true iff detecting edges using the magnitude of the colour gradient
+    bool myUseColourGradient;
+
+    /// true iff detecting edges using the magnitude of the z-depth gradient
+    bool myUseZGradient;
+
+    /// true iff detecting edges using changes in the Operator ID
+    bool myUseOpID;
+
+    /// Min magnitude of the colour gradient that will be considered an edge
+    /// Units are: colour units / pixel
+    float myColourGradientThreshold;
+
+    /// Min magnitude of the z-depth gradient that will be considered an edge
+    /// Units are: distance units / pixel
+    float myZGradientThreshold;
+
+    /// Normalizing coefficients computed by edgeDetectSumX2()
+    /// @{
+    float myColourSumX2;
+    float myColourSumY2;
+    float myZSumX2;
+    float myZSumY2;
+    /// @}
+
+    /// Filter half-widths (rounded down) in sample counts
+    /// @{
+    int myColourSamplesHalfX;
+    int myColourSamplesHalfY;
+    int myZSamplesHalfX;
+    int myZSamplesHalfY;
+    int myOpIDSamplesHalfX;
+    int myOpIDSamplesHalfY;
+    /// @}
+};
+
+/// Returns the sum of the squared sample offsets over a filter of the given
+/// width in pixels, and the half width of the filter in samples.
+inline float
+edgeDetectSumX2(int samplesperpixel, float width, int &halfsamplewidth)
+{
+    float sumx2 = 0;
+    if (samplesperpixel & 1)
+    {
+        // NOTE: This omits the middle sample
+        halfsamplewidth = (int)SYSfloor(float(samplesperpixel)*0.5f*width);
+
+        // There's a close form for this sum, but I figured I'd write it out in full,
+        // since it's not a bottleneck.
+        for (int i = -halfsamplewidth; i <= halfsamplewidth; ++i)
+        {
+            float x = float(i)/float(samplesperpixel);
+            sumx2 += x*x;
+        }
+    }
+    else
+    {
+        halfsamplewidth = (int)SYSfloor(float(samplesperpixel)*0.5f*width + 0.5f);
+
+        // There's a close form for this sum, but I figured I'd write it out in full,
+        // since it's not a bottleneck.
+        for (int i = -halfsamplewidth; i < halfsamplewidth; ++i)
+        {
+            float x = (float(i)+0.5f)/float(samplesperpixel);
+            sumx2 += x*x;
+        }
+    }
+    return sumx2;
+}
+
+/// Filters a range of destination rows.
+///
+/// The gradients are separable: the x gradient of a pixel is the sum over
+/// the columns of its window of x times the column's sum of samples, and
+/// the y gradient is the sum over the columns of the column's sum of y
+/// times the samples.  So for every destination row we first sum up the
+/// window rows of every source column once, and then every pixel of the
+/// row only has to loop over the columns of its window.  The Op ID and
+/// far z checks are done the same way with per column minima, maxima and
+/// counts.
+class vray_EdgeDetectRows
+{
+public:
+    vray_EdgeDetectRows(
+        const VRAY_DemoEdgeDetectParms &filter,
+        float *destination,
+        int vectorsize,
+        const float *colourdata,
+        const float *zdata,
+        const float *opiddata,
+        int sourcewidth,
+        int destwidth,
+        int destxoffsetinsource,
+        int destyoffsetinsource)
+        : myFilter(filter)
+        , myDestination(destination)
+        , myVectorSize(vectorsize)
+        , myColourData(colourdata)
+        , myZData(zdata)
+        , myOpIDData(opiddata)
+        , mySourceWidth(sourcewidth)
+        , myDestWidth(destwidth)
+        , myDestXOffset(destxoffsetinsource)
+        , myDestYOffset(destyoffsetinsource)
+    {
+        // Find the range of source columns read by any pixel
+        const VRAY_DemoEdgeDetectParms &f = myFilter;
+        const int lastpixel = myDestXOffset + (myDestWidth-1)*f.mySamplesPerPixelX;
+        myFirstColumn = myDestXOffset;
+        myLastColumn = lastpixel + f.mySamplesPerPixelX-1;
+        if (f.myUseColourGradient)
+            updateColumns(lastpixel, f.myColourSamplesHalfX);
+        if (f.myUseZGradient)
+            updateColumns(lastpixel, f.myZSamplesHalfX);
+        if (f.myUseOpID)
+            updateColumns(lastpixel, f.myOpIDSamplesHalfX);
+    }
+
+    void operator()(const UT_BlockedRange<int> &r) const
+    {
+        const int ncolumns = myLastColumn - myFirstColumn + 1;
+
+        // Per column sums of the window rows, reused for every row
+        UT_Array<float> coloursum;
+        UT_Array<float> colourysum;
+        UT_Array<float> zsum;
+        UT_Array<float> zysum;
+        UT_Array<int> zfarcount;
+        UT_Array<int> znearcount;
+        UT_Array<float> opidmin;
+        UT_Array<float> opidmax;
+
+        if (myFilter.myUseColourGradient)
+        {
+            coloursum.setSize(ncolumns*myVectorSize);
+            colourysum.setSize(ncolumns*myVectorSize);
+        }
+        if (myFilter.myUseZGradient)
+        {
+            zsum.setSize(ncolumns);
+            zysum.setSize(ncolumns);
+            zfarcount.setSize(ncolumns);
+            znearcount.setSize(ncolumns);
+        }
+        if (myFilter.myUseOpID)
+        {
+            opidmin.setSize(ncolumns);
+            opidmax.setSize(ncolumns);
+        }
+
+        for (int desty = r.begin(); desty < r.end(); ++desty)
+        {
+            filterRow(desty,
+                      coloursum.array(), colourysum.array(),
+                      zsum.array(), zysum.array(),
+                      zfarcount.array(), znearcount.array(),
+                      opidmin.array(), opidmax.array());
+        }
+    }
+
+private:
+    void updateColumns(int lastpixel, int halfsamples)
+    {
+        const VRAY_DemoEdgeDetectParms &f = myFilter;
+        myFirstColumn = SYSmin(myFirstColumn,
+            myDestXOffset + (f.mySamplesPerPixelX>>1) - halfsamples);
+        myLastColumn = SYSmax(myLastColumn,
+            lastpixel + ((f.mySamplesPerPixelX-1)>>1) + halfsamples);
+    }
+
+    /// Adds a row of samples to the column sums, four values at a time.
+    static void accumulateRow(float *sum, float *ysum,
+                              const float *row, float y, int n)
+    {
+        const v4uf vy(y);
+        int i;
+        for (i = 0; i + 4 <= n; i += 4)
+        {
+            const v4uf value(row + i);
+            (v4uf(sum + i) + value).store(sum + i);
+            (v4uf(ysum + i) + vy*value).store(ysum + i);
+        }
+        for (; i < n; ++i)
+        {
+            sum[i] += row[i];
+            ysum[i] += y*row[i];
+        }
+    }
+
+    void filterRow(int desty,
+                   float *coloursum, float *colourysum,
+                   float *zsum, float *zysum,
+                   int *zfarcount, int *znearcount,
+                   float *opidmin, float *opidmax) const
+    {
+        const VRAY_DemoEdgeDetectParms &f = myFilter;
+        const int ncolumns = myLastColumn - myFirstColumn + 1;
+        const int vectorsize = myVectorSize;
+
+        // First, compute the sample bounds of the pixels in y
+        const int sourcefirsty = myDestYOffset + desty*f.mySamplesPerPixelY;
+        const int sourcelasty = sourcefirsty + f.mySamplesPerPixelY-1;
+        const float middley = 0.5f*float(sourcelasty + sourcefirsty);
+        // Find the first and last sample rows for colour and z gradients
+        const int sourcefirstcy = sourcefirsty + (f.mySamplesPerPixelY>>1) - f.myColourSamplesHalfY;
+        const int sourcefirstzy = sourcefirsty + (f.mySamplesPerPixelY>>1) - f.myZSamplesHalfY;
+        const int sourcefirstoy = sourcefirsty + (f.mySamplesPerPixelY>>1) - f.myOpIDSamplesHalfY;
+        const int sourcelastcy = sourcefirsty + ((f.mySamplesPerPixelY-1)>>1) + f.myColourSamplesHalfY;
+        const int sourcelastzy = sourcefirsty + ((f.mySamplesPerPixelY-1)>>1) + f.myZSamplesHalfY;
+        const int sourcelastoy = sourcefirsty + ((f.mySamplesPerPixelY-1)>>1) + f.myOpIDSamplesHalfY;
+
+        // Column pass: sum up the window rows of every column
+        if (f.myUseColourGradient)
+        {
+            const int n = ncolumns*vectorsize;
+            memset(coloursum, 0, n*sizeof(float));
+            memset(colourysum, 0, n*sizeof(float));
+            for (int sourcey = sourcefirstcy; sourcey <= sourcelastcy; ++sourcey)
+            {
+                float y = (float(sourcey) - middley)/float(f.mySamplesPerPixelY);
+                const float *row = myColourData +
+                    vectorsize*(myFirstColumn + mySourceWidth*sourcey);
+                accumulateRow(coloursum, colourysum, row, y, n);
+            }
+        }
+        if (f.myUseZGradient)
+        {
+            memset(zsum, 0, ncolumns*sizeof(float));
+            memset(zysum, 0, ncolumns*sizeof(float));
+            memset(zfarcount, 0, ncolumns*sizeof(int));
+            memset(znearcount, 0, ncolumns*sizeof(int));
+            for (int sourcey = sourcefirstzy; sourcey <= sourcelastzy; ++sourcey)
+            {
+                float y = (float(sourcey) - middley)/float(f.mySamplesPerPixelY);
+                const float *row = myZData + myFirstColumn + mySourceWidth*sourcey;
+                for (int c = 0; c < ncolumns; ++c)
+                {
+                    // Special case for if nothing was hit, since may sum past FLT_MAX,
+                    // and then values won't cancel out to get a gradient of zero.
+                    if (row[c] >= 1.0e37)
+                        ++zfarcount[c];
+                    else
+                    {
+                        ++znearcount[c];
+                        zsum[c] += row[c];
+                        zysum[c] += y*row[c];
+                    }
+                }
+            }
+        }
+        const bool hasopidrows = (sourcefirstoy <= sourcelastoy);
+        if (f.myUseOpID && hasopidrows)
+        {
+            const float *row = myOpIDData + myFirstColumn + mySourceWidth*sourcefirstoy;
+            for (int c = 0; c < ncolumns; ++c)
+                opidmin[c] = opidmax[c] = row[c];
+            for (int sourcey = sourcefirstoy+1; sourcey <= sourcelastoy; ++sourcey)
+            {
+                row = myOpIDData + myFirstColumn + mySourceWidth*sourcey;
+                for (int c = 0; c < ncolumns; ++c)
+                {
+                    opidmin[c] = SYSmin(opidmin[c], row[c]);
+                    opidmax[c] = SYSmax(opidmax[c], row[c]);
+                }
+            }
+        }
+
+        UT_StackBuffer<float> colourgradientx(vectorsize);
+        UT_StackBuffer<float> colourgradienty(vectorsize);
+        float *destination = myDestination + desty*myDestWidth*vectorsize;
+
+        // Row pass: combine the columns of each pixel's windows
+        for (int destx = 0; destx < myDestWidth; ++destx)
+        {
+            bool isedge = false;
+
+            // Compute the sample bounds of the pixel in x, relative to
+            // the first column we summed up
+            const int sourcefirstx = myDestXOffset + destx*f.mySamplesPerPixelX - myFirstColumn;
+            const int sourcelastx = sourcefirstx + f.mySamplesPerPixelX-1;
+            const float middlex = 0.5f*float(sourcelastx + sourcefirstx);
+            // Find the first and last sample columns for each check
+            const int sourcefirstcx = sourcefirstx + (f.mySamplesPerPixelX>>1) - f.myColourSamplesHalfX;
+            const int sourcefirstzx = sourcefirstx + (f.mySamplesPerPixelX>>1) - f.myZSamplesHalfX;
+            const int sourcefirstox = sourcefirstx + (f.mySamplesPerPixelX>>1) - f.myOpIDSamplesHalfX;
+            const int sourcelastcx = sourcefirstx + ((f.mySamplesPerPixelX-1)>>1) + f.myColourSamplesHalfX;
+            const int sourcelastzx = sourcefirstx + ((f.mySamplesPerPixelX-1)>>1) + f.myZSamplesHalfX;
+            const int sourcelastox = sourcefirstx + ((f.mySamplesPerPixelX-1)>>1) + f.myOpIDSamplesHalfX;
+
+            // Found edge if not all of the op IDs of the samples match
+            if (f.myUseOpID && hasopidrows && sourcefirstox <= sourcelastox)
+            {
+                float lo = opidmin[sourcefirstox];
+                float hi = opidmax[sourcefirstox];
+                for (int c = sourcefirstox+1; c <= sourcelastox; ++c)
+                {
+                    lo = SYSmin(lo, opidmin[c]);
+                    hi = SYSmax(hi, opidmax[c]);
+                }
+                isedge = (lo != hi);
+            }
+
+            // Found edge if some, but not all, of the z samples hit nothing
+            bool hasnonfarz = false;
+            if (!isedge && f.myUseZGradient)
+            {
+                int nfar = 0;
+                int nnear = 0;
+                for (int c = sourcefirstzx; c <= sourcelastzx; ++c)
+                {
+                    nfar += zfarcount[c];
+                    nnear += znearcount[c];
+                }
+                hasnonfarz = (nnear > 0);
+                isedge = (nfar > 0 && nnear > 0);
+            }
+
+            if (!isedge && f.myUseColourGradient)
+            {
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradientx[i] = 0;
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradienty[i] = 0;
+                for (int c = sourcefirstcx; c <= sourcelastcx; ++c)
+                {
+                    // Find x of column relative to *middle* of pixel
+                    float x = (float(c) - middlex)/float(f.mySamplesPerPixelX);
+                    const float *sum = coloursum + c*vectorsize;
+                    const float *ysum = colourysum + c*vectorsize;
+                    for (int i = 0; i < vectorsize; ++i)
+                        colourgradientx[i] += x*sum[i];
+                    for (int i = 0; i < vectorsize; ++i)
+                        colourgradienty[i] += ysum[i];
+                }
+
+                int nx = sourcelastcx-sourcefirstcx+1;
+                int ny = sourcelastcy-sourcefirstcy+1;
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradientx[i] /= (ny*f.myColourSumX2);
+                float mag2x = 0;
+                for (int i = 0; i < vectorsize; ++i)
+                    mag2x += colourgradientx[i]*colourgradientx[i];
+
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradienty[i] /= (nx*f.myColourSumY2);
+                float mag2y = 0;
+                for (int i = 0; i < vectorsize; ++i)
+                    mag2y += colourgradienty[i]*colourgradienty[i];
+
+                if ((mag2x + mag2y) >= f.myColourGradientThreshold*f.myColourGradientThreshold)
+                    isedge = true;
+            }
+            if (!isedge && f.myUseZGradient && hasnonfarz)
+            {
+                float zgradientx = 0;
+                float zgradienty = 0;
+                float zaverage = 0;
+                for (int c = sourcefirstzx; c <= sourcelastzx; ++c)
+                {
+                    float x = (float(c) - middlex)/float(f.mySamplesPerPixelX);
+                    zgradientx += x*zsum[c];
+                    zgradienty += zysum[c];
+                    zaverage += zsum[c];
+                }
+
+                int nx = sourcelastzx-sourcefirstzx+1;
+                int ny = sourcelastzy-sourcefirstzy+1;
+                zaverage /= float(nx)*float(ny);
+                zgradientx /= (ny*f.myZSumX2*zaverage);
+                zgradienty /= (nx*f.myZSumY2*zaverage);
+                float mag2x = zgradientx*zgradientx;
+                float mag2y = zgradienty*zgradienty;
+
+                if ((mag2x + mag2y) >= f.myZGradientThreshold*f.myZGradientThreshold)
+                    isedge = true;
+            }
+
+            float value = isedge ? 1.0f : 0.0f;
+            for (int i = 0; i < vectorsize; ++i, ++destination)
+                *destination = value;
+        }
+    }
+
+    const VRAY_DemoEdgeDetectParms &myFilter;
+    float *myDestination;
+    int myVectorSize;
+    const float *myColourData;
+    const float *myZData;
+    const float *myOpIDData;
+    int mySourceWidth;
+    int myDestWidth;
+    int myDestXOffset;
+    int myDestYOffset;
+    int myFirstColumn;
+    int myLastColumn;
+};
+
+/// Detects edges in the destination region, filtering rows in parallel.
+/// Each destination pixel gets vectorsize components of 1 on an edge and 0
+/// elsewhere.  Data for disabled checks may be NULL.
+inline void
+edgeDetect(
+    const VRAY_DemoEdgeDetectParms &parms,
+    float *destination,
+    int vectorsize,
+    const float *colourdata,
+    const float *zdata,
+    const float *opiddata,
+    int sourcewidth,
+    int destwidth,
+    int destheight,
+    int destxoffsetinsource,
+    int destyoffsetinsource)
+{
+    if (destwidth <= 0 || destheight <= 0)
+        return;
+
+    // Every row only writes its own destination pixels.
+    UTparallelFor(UT_BlockedRange<int>(0, destheight),
+                  vray_EdgeDetectRows(parms, destination, vectorsize,
+                                      colourdata, zdata, opiddata,
+                                      sourcewidth, destwidth,
+                                      destxoffsetinsource,
+                                      destyoffsetinsource));
+}
+
+/// The original, unoptimized edge detection, which loops over the whole
+/// neighbourhood of every pixel.  It's kept as a reference for checking
+/// edgeDetect() against.  If given, colourmag2 and zmag2 receive the
+/// squared gradient magnitude each pixel was compared against its
+/// threshold with, or -1 if that test wasn't reached.
+inline void
+edgeDetectReference(
+    const VRAY_DemoEdgeDetectParms &parms,
+    float *destination,
+    int vectorsize,
+    const float *colourdata,
+    const float *zdata,
+    const float *opiddata,
+    int sourcewidth,
+    int destwidth,
+    int destheight,
+    int destxoffsetinsource,
+    int destyoffsetinsource,
+    float *colourmag2 = 0,
+    float *zmag2 = 0)
+{
+    for (int desty = 0; desty < destheight; ++desty)
+    {
+        for (int destx = 0; destx < destwidth; ++destx)
+        {
+            bool isedge = false;
+            float pixelcolourmag2 = -1;
+            float pixelzmag2 = -1;
+
+            // First, compute the sample bounds of the pixel
+            const int sourcefirstx = destxoffsetinsource + destx*parms.mySamplesPerPixelX;
+            const int sourcefirsty = destyoffsetinsource + desty*parms.mySamplesPerPixelY;
+            const int sourcelastx = sourcefirstx + parms.mySamplesPerPixelX-1;
+            const int sourcelasty = sourcefirsty + parms.mySamplesPerPixelY-1;
+            // Find the first sample to read for colour and z gradients
+            const int sourcefirstcx = sourcefirstx + (parms.mySamplesPerPixelX>>1) - parms.myColourSamplesHalfX;
+            const int sourcefirstcy = sourcefirsty + (parms.mySamplesPerPixelY>>1) - parms.myColourSamplesHalfY;
+            const int sourcefirstzx = sourcefirstx + (parms.mySamplesPerPixelX>>1) - parms.myZSamplesHalfX;
+            const int sourcefirstzy = sourcefirsty + (parms.mySamplesPerPixelY>>1) - parms.myZSamplesHalfY;
+            const int sourcefirstox = sourcefirstx + (parms.mySamplesPerPixelX>>1) - parms.myOpIDSamplesHalfX;
+            const int sourcefirstoy = sourcefirsty + (parms.mySamplesPerPixelY>>1) - parms.myOpIDSamplesHalfY;
+            // Find the last sample to read for colour and z gradients
+            const int sourcelastcx = sourcefirstx + ((parms.mySamplesPerPixelX-1)>>1) + parms.myColourSamplesHalfX;
+            const int sourcelastcy = sourcefirsty + ((parms.mySamplesPerPixelY-1)>>1) + parms.myColourSamplesHalfY;
+            const int sourcelastzx = sourcefirstx + ((parms.mySamplesPerPixelX-1)>>1) + parms.myZSamplesHalfX;
+            const int sourcelastzy = sourcefirsty + ((parms.mySamplesPerPixelY-1)>>1) + parms.myZSamplesHalfY;
+            const int sourcelastox = sourcefirstx + ((parms.mySamplesPerPixelX-1)>>1) + parms.myOpIDSamplesHalfX;
+            const int sourcelastoy = sourcefirsty + ((parms.mySamplesPerPixelY-1)>>1) + parms.myOpIDSamplesHalfY;
+            // Find the first and last that will be read
+            int sourcefirstrx = sourcefirstx;
+            int sourcefirstry = sourcefirsty;
+            int sourcelastrx = sourcelastx;
+            int sourcelastry = sourcelasty;
+            if (parms.myUseColourGradient)
+            {
+                sourcefirstrx = SYSmin(sourcefirstrx, sourcefirstcx);
+                sourcefirstry = SYSmin(sourcefirstry, sourcefirstcy);
+                sourcelastrx = SYSmax(sourcelastrx, sourcelastcx);
+                sourcelastry = SYSmax(sourcelastry, sourcelastcy);
+            }
+            if (parms.myUseZGradient)
+            {
+                sourcefirstrx = SYSmin(sourcefirstrx, sourcefirstzx);
+                sourcefirstry = SYSmin(sourcefirstry, sourcefirstzy);
+                sourcelastrx = SYSmax(sourcelastrx, sourcelastzx);
+                sourcelastry = SYSmax(sourcelastry, sourcelastzy);
+            }
+            if (parms.myUseOpID)
+            {
+                sourcefirstrx = SYSmin(sourcefirstrx, sourcefirstox);
+                sourcefirstry = SYSmin(sourcefirstry, sourcefirstoy);
+                sourcelastrx = SYSmax(sourcelastrx, sourcelastox);
+                sourcelastry = SYSmax(sourcelastry, sourcelastoy);
+            }
+
+            // Initialize data for use by each of the edge detection methods
+            bool opidset = false;
+            float opid;
+
+            UT_StackBuffer<float> colourgradientx(vectorsize);
+            UT_StackBuffer<float> colourgradienty(vectorsize);
+            if (parms.myUseColourGradient)
+            {
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradientx[i] = 0;
+                for (int i = 0; i < vectorsize; ++i)
+                    colourgradienty[i] = 0;
+            }
+
+            // The z channel only has one component, so its gradient doesn't need arrays.
+            float zgradientx = 0;
+            float zgradienty = 0;
+            float zaverage = 0;
+            bool hasfarz = false;
+            bool hasnonfarz = false;
+
+            for (int sourcey = sourcefirstry; sourcey <= sourcelastry && !isedge; ++sourcey)
+            {
+                for (int sourcex = sourcefirstrx; sourcex <= sourcelastrx; ++sourcex)
+                {
+                    int sourcei = sourcex + sourcewidth*sourcey;
+
+                    if (parms.myUseOpID && sourcex >= sourcefirstox && sourcex <= sourcelastox && sourcey >= sourcefirstoy && sourcey <= sourcelastoy)
+                    {
+                        // Found edge if not all of the op IDs of the samples match
+                        if (!opidset)
+                        {
+                            opid = opiddata[sourcei];
+                            opidset = true;
+                        }
+                        else if (opid != opiddata[sourcei])
+                        {
+                            isedge = true;
+                            break;
+                        }
+                    }
+
+                    if (parms.myUseColourGradient || parms.myUseZGradient)
+                    {
+                        // Find (x,y) of sample relative to *middle* of pixel
+                        float x = (float(sourcex) - 0.5f*float(sourcelastx + sourcefirstx))/float(parms.mySamplesPerPixelX);
+                        float y = (float(sourcey) - 0.5f*float(sourcelasty + sourcefirsty))/float(parms.mySamplesPerPixelY);
+
+                        if (parms.myUseColourGradient && sourcex >= sourcefirstcx && sourcex <= sourcelastcx && sourcey >= sourcefirstcy && sourcey <= sourcelastcy)
+                        {
+                            for (int i = 0; i < vectorsize; ++i)
+                                colourgradientx[i] += x*colourdata[vectorsize*sourcei + i];
+                            for (int i = 0; i < vectorsize; ++i)
+                                colourgradienty[i] += y*colourdata[vectorsize*sourcei + i];
+                        }
+                        if (parms.myUseZGradient && sourcex >= sourcefirstzx && sourcex <= sourcelastzx && sourcey >= sourcefirstzy && sourcey <= sourcelastzy)
+                        {
+                            // Special case for if nothing was hit, since may sum past FLT_MAX,
+                            // and then values won't cancel out to get a gradient of zero.
+                            bool farz = (zdata[sourcei] >= 1.0e37);
+                            hasfarz |= farz;
+                            hasnonfarz |= !farz;
+                            if (hasfarz && hasnonfarz)
+                            {
+                                isedge = true;
+                                break;
+                            }
+                            if (!farz)
+                            {
+                                zgradientx += x*zdata[sourcei];
+                                zgradienty += y*zdata[sourcei];
+                                zaverage += zdata[sourcei];
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (!isedge)
+            {
+                if (parms.myUseColourGradient)
+                {
+                    int nx = sourcelastcx-sourcefirstcx+1;
+                    int ny = sourcelastcy-sourcefirstcy+1;
+                    for (int i = 0; i < vectorsize; ++i)
+                        colourgradientx[i] /= (ny*parms.myColourSumX2);
+                    float mag2x = 0;
+                    for (int i = 0; i < vectorsize; ++i)
+                        mag2x += colourgradientx[i]*colourgradientx[i];
+
+                    for (int i = 0; i < vectorsize; ++i)
+                        colourgradienty[i] /= (nx*parms.myColourSumY2);
+                    float mag2y = 0;
+                    for (int i = 0; i < vectorsize; ++i)
+                        mag2y += colourgradienty[i]*colourgradienty[i];
+
+                    pixelcolourmag2 = mag2x + mag2y;
+                    if ((mag2x + mag2y) >= parms.myColourGradientThreshold*parms.myColourGradientThreshold)
+                        isedge = true;
+                }
+                if (!isedge && parms.myUseZGradient && hasnonfarz)
+                {
+                    int nx = sourcelastzx-sourcefirstzx+1;
+                    int ny = sourcelastzy-sourcefirstzy+1;
+                    zaverage /= float(nx)*float(ny);
+                    zgradientx /= (ny*parms.myZSumX2*zaverage);
+                    zgradienty /= (nx*parms.myZSumY2*zaverage);
+                    float mag2x = zgradientx*zgradientx;
+                    float mag2y = zgradienty*zgradienty;
+
+                    pixelzmag2 = mag2x + mag2y;
+                    if ((mag2x + mag2y) >= parms.myZGradientThreshold*parms.myZGradientThreshold)
+                        isedge = true;
+                }
+            }
+
+            if (colourmag2)
+                colourmag2[destx + destwidth*desty] = pixelcolourmag2;
+            if (zmag2)
+                zmag2[destx + destwidth*desty] = pixelzmag2;
+
+            float value = isedge ? 1.0f : 0.0f;
+            for (int i = 0; i < vectorsize; ++i, ++destination)
+                *destination = value;
+        }
+    }
+}
+
+} // End HDK_Sample namespace
+
+#endif
@@ -33,6 +33,8 @@
 #include <UT/UT_String.h>
 #include <VRAY/VRAY_Procedural.h>
 
+class GU_Detail;
+
 namespace HDK_Sample {
 
 /// @brief A procedural which does a deferred load of geometry from disk
@@ -47,11 +49,18 @@ public:
     virtual void	 render();
 
 private:
+    /// Loads the file into gdp, going through the shared geometry cache
+    /// unless it's disabled.
+    bool		 loadGeometry(GU_Detail *gdp,
+				      const UT_StringHolder &file) const;
+
     UT_BoundingBox	 myBox;
     UT_StringHolder	 myFile, myBlurFile;
     fpreal		 myShutter;
     bool		 myVelocityBlur;
     fpreal		 myPreBlur, myPostBlur;
+    bool		 myUseCache;
+    int64		 myCacheSize;
 };
 
 }	// End HDK_Sample namespace
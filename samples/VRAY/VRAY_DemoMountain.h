@@ -30,10 +30,13 @@
 #define __VRAY_DemoBox__
 
 #include <UT/UT_BoundingBox.h>
+#include <UT/UT_SharedPtr.h>
 #include <VRAY/VRAY_Procedural.h>
 
 namespace HDK_Sample {
 
+class vray_MountainBudget;
+
 class FractalPoint {
 public:
     void	assign(fpreal x, fpreal y, fpreal z, uint s)
@@ -58,15 +61,23 @@ public:
     /// Split into 4 new procedurals (each rendering a triangle)
     void		fractalSplit();	
 
-    /// Render triangle geometry
-    void		fractalRender();
+    /// Render triangle geometry, subdivided the given number of times
+    void		fractalRender(int levels);
 
 private:
+    /// Number of times the triangle needs to be subdivided to bring the
+    /// screen space error of the displacement under the threshold
+    int			computeLevels(fpreal lod) const;
+
     /// Compute bounding box (including displacement or not)
     void		computeBounds(UT_BoundingBox &box,
 					bool include_displace);
     FractalPoint	 myP[3];
     int			 mySplits;
+
+    /// Settings and primitive budget shared by all the procedurals split
+    /// from the same mountain
+    UT_SharedPtr<vray_MountainBudget>	myBudget;
 };
 
 }	// End HDK_Sample namespace
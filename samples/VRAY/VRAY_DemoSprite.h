@@ -31,13 +31,22 @@
 
 #include <VRAY/VRAY_Procedural.h>
 #include <GU/GU_Detail.h>
+#include <UT/UT_Array.h>
 #include <UT/UT_BoundingBox.h>
-#include <UT/UT_IntArray.h>
 
 namespace HDK_Sample {
 
 class vray_SpriteAttribMap;
 
+/// A point of the sprite cloud along with the Morton code of its position.
+/// The points are sorted by code, so every octree cell of the cloud is a
+/// contiguous run of points.
+class vray_SpritePoint {
+public:
+    uint64			 myCode;
+    GA_Offset			 myOffset;
+};
+
 class VRAY_DemoSpriteParms {
 public:
     // Data which is uniform for all splits
@@ -53,6 +62,7 @@ public:
     int				 myRefCount;
     UT_Matrix3			 myViewRotation;
     vray_SpriteAttribMap	*myAttribMap;
+    UT_Array<vray_SpritePoint>	 myPoints;
 };
 
 class VRAY_DemoSprite : public VRAY_Procedural {
@@ -63,7 +73,7 @@ public:
     virtual const char	*className() const;
     virtual int		 initialize(const UT_BoundingBox *box);
     int			 initChild(VRAY_DemoSprite *sprite,
-				    const UT_BoundingBox &box);
+				    exint start, exint end);
     virtual void	 getBoundingBox(UT_BoundingBox &box);
     virtual void	 render();
 
@@ -71,13 +81,19 @@ private:
     const GU_Detail	*getPointGdp() const	{ return myParms->myGdp; }
     fpreal		 getTime() const	{ return myParms->myTimeScale; }
     int			 getChunk() const	{ return myParms->myChunkSize; }
+    exint		 getNumPoints() const	{ return myEnd - myStart; }
+
+    /// Computes myBox and myVelBox from the points in [myStart, myEnd)
+    void		 computeBounds();
 
     VRAY_DemoSpriteParms	*myParms;
 
     // Data which is unique per procedural
     UT_BoundingBox	 myBox;
     UT_BoundingBox	 myVelBox;
-    UT_IntArray		 myPointList;
+    // The range of myParms->myPoints rendered by this procedural
+    exint		 myStart;
+    exint		 myEnd;
 };
 
 }	// End HDK_Sample namespace
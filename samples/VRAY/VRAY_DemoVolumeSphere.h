@@ -52,6 +52,7 @@ public:
 
 private:
     UT_BoundingBox	 myBox;
+    fpreal		 myFalloff;
 };
 
 }	// End HDK_Sample namespace
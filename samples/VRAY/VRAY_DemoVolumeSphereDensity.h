@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015
+ *	Side Effects Software Inc.  All rights reserved.
+ *
+ * Redistribution and use of Houdini Development Kit samples in source and
+ * binary forms, with or without modification, are permitted provided that the
+ * following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. The name of Side Effects Software may not be used to endorse or
+ *    promote products derived from this software without specific prior
+ *    written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY SIDE EFFECTS SOFTWARE `AS IS' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN
+ * NO EVENT SHALL SIDE EFFECTS SOFTWARE BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA,
+ * OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *----------------------------------------------------------------------------
+ * The density of the volumetric sphere of VRAY_DemoVolumeSphere, and the
+ * boxes that bound it, shared with the standalone volumespherebench program.
+ */
+
+#pragma once
+
+#ifndef __VRAY_DemoVolumeSphereDensity__
+#define __VRAY_DemoVolumeSphereDensity__
+
+#include <UT/UT_Array.h>
+#include <UT/UT_BoundingBox.h>
+#include <UT/UT_Vector3.h>
+#include <SYS/SYS_Math.h>
+
+// Number of times the bounds of the sphere are subdivided to find the
+// boxes containing density.
+#define BOX_LEVELS	3
+
+namespace HDK_Sample {
+
+/// The density falls off smoothly from 1 to 0 over the outer falloff
+/// width of the unit sphere.  A falloff of 0 gives a hard surface.
+inline float
+vraySphereDensity(const UT_Vector3 &pos, float falloff)
+{
+    if (falloff > 0)
+    {
+	float t = SYSclamp((1.0F - pos.length())/falloff, 0.0F, 1.0F);
+	return t*t*(3.0F - 2.0F*t);
+    }
+    return (pos.length2() < 1.0F) ? 1.0F : 0.0F;
+}
+
+inline float
+vraySphereStepSize(float falloff)
+{
+    // Take a few steps through the falloff so that it's resolved smoothly,
+    // but don't step more coarsely than we need to for a hard sphere.
+    if (falloff > 0)
+	return SYSmin(0.1F, 0.25F*falloff);
+    return 0.1F;
+}
+
+// Recursively subdivides the box, adding the parts that overlap the unit
+// sphere.  Boxes that are completely outside the sphere have no density and
+// are skipped, while boxes that are completely inside don't need to be
+// subdivided further.
+inline void
+vraySphereBoxes(UT_Array<UT_BoundingBox> &boxes, const UT_BoundingBox &box,
+		float expand, int level)
+{
+    float	mindist2 = 0;
+    float	maxdist2 = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+	float lo = box.vals[axis][0];
+	float hi = box.vals[axis][1];
+	float nearest = SYSclamp(0.0F, lo, hi);
+	float farthest = SYSmax(SYSabs(lo), SYSabs(hi));
+	mindist2 += nearest*nearest;
+	maxdist2 += farthest*farthest;
+    }
+
+    if (mindist2 >= 1.0F)
+	return;
+
+    if (maxdist2 <= 1.0F || level >= BOX_LEVELS)
+    {
+	UT_BoundingBox	bounds(box);
+	bounds.expandBounds(0, expand);
+	boxes.append(bounds);
+	return;
+    }
+
+    UT_Vector3	center = box.center();
+    for (int i = 0; i < 8; ++i)
+    {
+	UT_BoundingBox	child;
+	child.initBounds(center);
+	child.enlargeBounds(box.vals[0][i & 1],
+			    box.vals[1][(i >> 1) & 1],
+			    box.vals[2][(i >> 2) & 1]);
+	vraySphereBoxes(boxes, child, expand, level+1);
+    }
+}
+
+} // End HDK_Sample namespace
+
+#endif
@@ -27,6 +27,9 @@
 #define __ROP_Field3D_h__
 
 #include <ROP/ROP_Node.h>
+#include <UT/UT_Array.h>
+#include <UT/UT_Condition.h>
+#include <UT/UT_Lock.h>
 
 #define STR_PARM(name, vi, t) \
 		{ evalString(str, name, vi, t); }
@@ -35,9 +38,12 @@
 
 class OP_TemplatePair;
 class OP_VariablePair;
+class UT_Thread;
 
 namespace HDK_Sample {
 
+class rop_F3DFrame;
+
 enum {
     ROP_F3D_RENDER,
     ROP_F3D_RENDER_CTRL,
@@ -49,6 +55,9 @@ enum {
     ROP_F3D_GRIDTYPE,
     ROP_F3D_BITDEPTH,
     ROP_F3D_COLLATE,
+    ROP_F3D_THREADED,
+    ROP_F3D_ASYNCWRITE,
+    ROP_F3D_ASYNCQUEUE,
     ROP_F3D_INITSIM,
     ROP_F3D_ALFPROGRESS,
     ROP_F3D_TPRERENDER,
@@ -120,10 +129,35 @@ public:
 
     bool	COLLATE(double t)
 		    { INT_PARM("collatevector", 0, t) }
+    bool	THREADED(double t)
+		    { INT_PARM("threadedio", 0, t) }
+    bool	ASYNCWRITE()
+		    { INT_PARM("asyncwrite", 0, 0) }
+    int		ASYNCQUEUE()
+		    { INT_PARM("asyncqueue", 0, 0) }
 
 private:
+    /// Background writing.  Frames are queued as detached copies of the
+    /// cooked geometry and written by a single writer thread, so the
+    /// next frame can cook while the previous one is being saved.
+    void			 queueFrame(rop_F3DFrame *frame, int maxqueue);
+    void			 waitForWrites();
+    static void			*writerEntry(void *data);
+    void			 writerLoop();
+    void			 writeFrame(rop_F3DFrame *frame);
+    void			 reportProgress(bool alfprogress, fpreal time,
+						fpreal64 seconds);
+
     fpreal		 myEndTime;
     fpreal		 myStartTime;
+
+    UT_Thread			*myWriter;
+    UT_Lock			 myQueueLock;
+    // Triggered whenever the queue changes or the writer goes idle.
+    UT_Condition		 myQueueCond;
+    UT_Array<rop_F3DFrame *>	 myQueue;
+    bool			 myWriterBusy;
+    int				 myFailedWrites;
 };
 
 }	// End HDK_Sample namespace
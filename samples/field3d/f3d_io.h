@@ -46,11 +46,16 @@ enum F3D_GridType
     F3D_GRIDTYPE_SPARSE
 };
 
-GA_Detail::IOStatus f3d_fileLoad(GEO_Detail *gdp, const char *fname);
+// In threaded mode the layers of a file are converted concurrently.
+// Saving then keeps all the converted layers in memory until they have
+// been written.
+GA_Detail::IOStatus f3d_fileLoad(GEO_Detail *gdp, const char *fname,
+				 bool threaded);
 GA_Detail::IOStatus f3d_fileSave(const GEO_Detail *gdp, const char *fname,
 				 F3D_BitDepth bitdepth,
 				 F3D_GridType gridtype,
-				 bool collatevector);
+				 bool collatevector,
+				 bool threaded);
 
 }
 
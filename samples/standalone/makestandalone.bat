@@ -6,3 +6,6 @@ hcustom -s standalone.C
 hcustom -s traverse.C
 hcustom -s i3ddsmgen.C
 hcustom -s gengeovolume.C
+hcustom -s edgedetectcompare.C
+hcustom -s alligatorbench.C
+hcustom -s volumespherebench.C
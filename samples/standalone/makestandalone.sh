@@ -8,3 +8,6 @@ hcustom -s traverse.C
 hcustom -s i3ddsmgen.C
 hcustom -s gengeovolume.C
 hcustom -s tiledevice.C
+hcustom -s edgedetectcompare.C
+hcustom -s alligatorbench.C
+hcustom -s volumespherebench.C